@@ -1,11 +1,14 @@
 #include <iostream>
 #include <vector>
-#include <queue>
-#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <system_error>
 #include <fstream>
 #include <sstream>
 #include <algorithm>  // for std::transform
 #include <cctype>     // for ::tolower
+#include <cstdint>
+#include <unordered_set>
 
 using namespace std;
 
@@ -32,104 +35,359 @@ string normalize(const string &input) {
 // Aho–Corasick Structures
 // ------------------------
 
+// A single pattern occurrence reported by AhoCorasick::forEachMatch.
+// [start, end) are byte offsets into the scanned query.
+struct Match {
+    int patternId;
+    size_t start;
+    size_t end;
+};
+
+// Pattern ids already scored during one search. Matches per query are few, so a
+// short stack buffer scanned linearly avoids allocating or zeroing a per-rule table;
+// only unusually match-heavy queries spill into the set.
+class SeenPatterns {
+private:
+    static const size_t INLINE_CAPACITY = 32;
+    int inlineIds[INLINE_CAPACITY];
+    size_t inlineCount;
+    unordered_set<int> overflow;
+
+public:
+    SeenPatterns() : inlineCount(0) {}
+
+    // Returns true the first time an id is added
+    bool insert(int patternId) {
+        for (size_t i = 0; i < inlineCount; i++)
+            if (inlineIds[i] == patternId)
+                return false;
+        if (inlineCount < INLINE_CAPACITY) {
+            inlineIds[inlineCount++] = patternId;
+            return true;
+        }
+        return overflow.insert(patternId).second;
+    }
+};
+
+// Bump allocator over large fixed-size blocks. Runs are handed out contiguously and
+// never freed one by one; everything is released together with the pool.
+template <typename T, size_t BlockSize>
+class BlockPool {
+private:
+    vector<unique_ptr<T[]>> blocks;
+    size_t used;    // items handed out from the last block
+
+public:
+    BlockPool() : used(BlockSize) {}
+
+    // Contiguous run of n items, n <= BlockSize
+    T* allocate(size_t n) {
+        if (used + n > BlockSize) {
+            blocks.emplace_back(new T[BlockSize]);
+            used = 0;
+        }
+        T* run = &blocks.back()[used];
+        used += n;
+        return run;
+    }
+
+    size_t bytes() const { return blocks.size() * BlockSize * sizeof(T); }
+};
+
 // Trie Node structure
+// Nodes and their child runs come from pools owned by the automaton, so building
+// the trie allocates once per block rather than once per node or child list.
+// Pointers stay valid for the automaton's lifetime and are released with it.
 struct TrieNode {
-    unordered_map<char, TrieNode*> children;
+    char* labels;           // edge labels of the children, contiguous for a fast scan
+    TrieNode** targets;     // children, parallel to labels
     TrieNode* fail;
-    vector<string> matchedPatterns;
-    
-    TrieNode() : fail(nullptr) {}
+    TrieNode* output;       // dictionary suffix link: nearest node on the fail chain that ends a pattern
+    int patternId;          // pattern ending exactly at this node, or -1
+    int depth;              // distance from root, i.e. the length of the pattern ending here
+    uint16_t childCount;
+    uint16_t childCapacity; // size of the labels/targets runs
+
+    TrieNode() : labels(nullptr), targets(nullptr), fail(nullptr), output(nullptr),
+                 patternId(-1), depth(0), childCount(0), childCapacity(0) {}
+
+    TrieNode* child(char ch) const {
+        for (int i = 0; i < childCount; i++)
+            if (labels[i] == ch)
+                return targets[i];
+        return nullptr;
+    }
+};
+
+// ------------------------
+// Step 2: Tuned Scoring Function
+// ------------------------
+// Weighting: assign higher weight for more critical keywords.
+int patternWeight(const string& pattern) {
+    if (pattern.find("; drop") != string::npos || pattern.find("xp_cmdshell") != string::npos ||
+            pattern.find("; exec") != string::npos || pattern.find("outfile") != string::npos ||
+            pattern.find("load_file") != string::npos)
+        return 100;
+    else if (pattern.find("; delete") != string::npos || pattern.find("; insert") != string::npos ||
+             pattern.find("; truncate") != string::npos || pattern.find("; update") != string::npos ||
+             pattern.find("' alter") != string::npos || pattern.find("sleep(") != string::npos || 
+             pattern.find("version(") != string::npos || pattern.find("current_user") != string::npos)
+        return 15;
+    return 10;
+}
+
+// Per-tenant view of a shared automaton: which rules are enabled and how much each
+// one weighs, both indexed by pattern id. Tenants share the trie and only pay for a
+// bit and a 16-bit weight per rule. Setters grow the profile to cover new ids and
+// ignore negative ones; ids it does not cover, or that have no weight, count as disabled.
+struct TenantProfile {
+    static const int MAX_WEIGHT = 65535;
+
+    vector<uint64_t> enabled;   // one bit per pattern id
+    vector<uint16_t> weights;   // one weight per pattern id
+
+    bool isEnabled(int patternId) const {
+        if (patternId < 0)
+            return false;
+        size_t word = static_cast<size_t>(patternId) / 64;
+        return word < enabled.size() && ((enabled[word] >> (patternId % 64)) & 1);
+    }
+
+    bool hasWeight(int patternId) const {
+        return patternId >= 0 && static_cast<size_t>(patternId) < weights.size();
+    }
+
+    void setEnabled(int patternId, bool on) {
+        if (patternId < 0)
+            return;
+        size_t word = static_cast<size_t>(patternId) / 64;
+        if (word >= enabled.size())
+            enabled.resize(word + 1, 0);
+        uint64_t bit = uint64_t(1) << (patternId % 64);
+        if (on)
+            enabled[word] |= bit;
+        else
+            enabled[word] &= ~bit;
+    }
+
+    // Weights are clamped to [0, MAX_WEIGHT]
+    void setWeight(int patternId, int weight) {
+        if (patternId < 0)
+            return;
+        if (!hasWeight(patternId))
+            weights.resize(patternId + 1, 0);
+        if (weight < 0)
+            weight = 0;
+        else if (weight > MAX_WEIGHT)
+            weight = MAX_WEIGHT;
+        weights[patternId] = static_cast<uint16_t>(weight);
+    }
 };
 
 // Aho–Corasick Automaton Class
 class AhoCorasick {
 private:
+    BlockPool<TrieNode, 4096> nodePool;         // 192 KB blocks
+    BlockPool<char, 65536> labelPool;           // 64 KB blocks
+    BlockPool<TrieNode*, 8192> targetPool;      // 64 KB blocks
+    size_t nodes;
     TrieNode* root;
+    string patternText;             // every pattern back to back
+    vector<size_t> patternStarts;   // pattern id -> offset into patternText, plus an end sentinel
+    vector<int> weights;        // indexed by pattern id
+
+    // Levels smaller than this are linked on the calling thread
+    static const size_t PARALLEL_LEVEL_THRESHOLD = 4096;
+
+    TrieNode* newNode() {
+        nodes++;
+        return nodePool.allocate(1);
+    }
+
+    // Append a child, doubling the node's label/target runs when full. Outgrown
+    // runs stay in the pools; they are small since most nodes have one child.
+    void addChild(TrieNode* node, char ch, TrieNode* child) {
+        if (node->childCount == node->childCapacity) {
+            uint16_t capacity = node->childCapacity ? node->childCapacity * 2 : 1;
+            char* labels = labelPool.allocate(capacity);
+            TrieNode** targets = targetPool.allocate(capacity);
+            copy(node->labels, node->labels + node->childCount, labels);
+            copy(node->targets, node->targets + node->childCount, targets);
+            node->labels = labels;
+            node->targets = targets;
+            node->childCapacity = capacity;
+        }
+        node->labels[node->childCount] = ch;
+        node->targets[node->childCount++] = child;
+    }
+
+    // Set fail and output links for the children of parents[begin, end).
+    // Only reads nodes of lower depth, so disjoint ranges of one level can run concurrently.
+    void linkChildren(const vector<TrieNode*>& parents, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            TrieNode* current = parents[i];
+            for (int c = 0; c < current->childCount; c++) {
+                char ch = current->labels[c];
+                TrieNode* child = current->targets[c];
+                if (current == root) {
+                    child->fail = root;
+                } else {
+                    TrieNode* failure = current->fail;
+                    while (failure != root && !failure->child(ch))
+                        failure = failure->fail;
+                    TrieNode* next = failure->child(ch);
+                    child->fail = next ? next : root;
+                }
+                // Link to the longest proper suffix that is itself a pattern, instead of
+                // copying the fail node's matches into every child.
+                child->output = (child->fail->patternId != -1) ? child->fail : child->fail->output;
+            }
+        }
+    }
+
+    // Sum weightOf(id) once for each distinct pattern in the query that isEnabled(id)
+    template <typename Enabled, typename Weight>
+    int score(const string& query, Enabled isEnabled, Weight weightOf) const {
+        int riskScore = 0;
+        SeenPatterns patternFound; // track unique patterns
+        forEachMatch(query, [&](const Match& match) {
+            if (isEnabled(match.patternId) && patternFound.insert(match.patternId))
+                riskScore += weightOf(match.patternId);
+            return true;
+        });
+        return riskScore;
+    }
 
 public:
-    AhoCorasick() {
-        root = new TrieNode();
+    AhoCorasick() : nodes(0), patternStarts(1, 0) {
+        root = newNode();
     }
 
-    // Insert a keyword (assumed to be normalized already)
-    void insert(const string& keyword) {
+    // Nodes point into this automaton's pools
+    AhoCorasick(const AhoCorasick&) = delete;
+    AhoCorasick& operator=(const AhoCorasick&) = delete;
+
+    // Insert a keyword (assumed to be normalized already) and return its pattern id.
+    // Inserting the same keyword twice returns the id it was first given.
+    int insert(const string& keyword) {
         TrieNode* node = root;
         for (char ch : keyword) {
-            if (!node->children.count(ch))
-                node->children[ch] = new TrieNode();
-            node = node->children[ch];
+            TrieNode* next = node->child(ch);
+            if (!next) {
+                next = newNode();
+                next->depth = node->depth + 1;
+                addChild(node, ch, next);
+            }
+            node = next;
         }
-        node->matchedPatterns.push_back(keyword);
+        if (node->patternId == -1) {
+            node->patternId = static_cast<int>(patternCount());
+            patternText += keyword;
+            patternStarts.push_back(patternText.size());
+            weights.push_back(patternWeight(keyword));
+        }
+        return node->patternId;
     }
 
-    // Build failure links using BFS
-    void build() {
-        queue<TrieNode*> q;
+    // Build failure links and dictionary suffix links breadth-first, one trie level
+    // at a time. A node's links only depend on shallower nodes, so each large level
+    // is split across up to 'threads' workers (0 = hardware concurrency).
+    void build(unsigned threads = 0) {
+        if (threads == 0)
+            threads = max(1u, thread::hardware_concurrency());
         root->fail = root;
-        for (auto& pair : root->children) {
-            pair.second->fail = root;
-            q.push(pair.second);
-        }
-        while (!q.empty()) {
-            TrieNode* current = q.front();
-            q.pop();
-            for (auto& pair : current->children) {
-                char ch = pair.first;
-                TrieNode* child = pair.second;
-                TrieNode* failure = current->fail;
-                while (failure != root && !failure->children.count(ch))
-                    failure = failure->fail;
-                if (failure->children.count(ch))
-                    child->fail = failure->children[ch];
-                else
-                    child->fail = root;
-                // Combine matched patterns (could remove duplicates if needed)
-                child->matchedPatterns.insert(child->matchedPatterns.end(),
-                                              child->fail->matchedPatterns.begin(),
-                                              child->fail->matchedPatterns.end());
-                q.push(child);
+        vector<TrieNode*> level(1, root), nextLevel;
+        while (!level.empty()) {
+            size_t workers = min<size_t>(threads, level.size() / PARALLEL_LEVEL_THRESHOLD);
+            if (workers <= 1) {
+                linkChildren(level, 0, level.size());
+            } else {
+                vector<thread> pool;
+                pool.reserve(workers);
+                size_t chunk = (level.size() + workers - 1) / workers;
+                size_t begin = 0;
+                try {
+                    for (; begin < level.size(); begin += chunk)
+                        pool.emplace_back(&AhoCorasick::linkChildren, this, cref(level),
+                                          begin, min(begin + chunk, level.size()));
+                } catch (const system_error&) {
+                    // Could not start another worker: link the rest on this thread
+                    linkChildren(level, begin, level.size());
+                }
+                for (thread& worker : pool)
+                    worker.join();
             }
+            nextLevel.clear();
+            for (TrieNode* node : level)
+                nextLevel.insert(nextLevel.end(), node->targets, node->targets + node->childCount);
+            level.swap(nextLevel);
         }
     }
 
-    // ------------------------
-    // Step 2: Tuned Scoring Function
-    // ------------------------
-    // Search for SQLi patterns in the (normalized) query.
-    // Uses a map to count each distinct pattern only once.
-    int search(const string& query) {
-        // Assume query is already normalized
-        TrieNode* node = root;
-        int riskScore = 0;
-        unordered_map<string, bool> patternFound; // track unique patterns
+    size_t nodeCount() const { return nodes; }
+
+    // Approximate heap footprint of the automaton in bytes
+    size_t memoryUsage() const {
+        size_t bytes = nodePool.bytes() + labelPool.bytes() + targetPool.bytes();
+        bytes += patternText.capacity() + patternStarts.capacity() * sizeof(size_t);
+        bytes += weights.capacity() * sizeof(int);
+        return bytes;
+    }
+
+    size_t patternCount() const { return patternStarts.size() - 1; }
+    string pattern(int patternId) const {
+        return patternText.substr(patternStarts[patternId], patternStarts[patternId + 1] - patternStarts[patternId]);
+    }
 
-        for (char ch : query) {
-            while (node != root && !node->children.count(ch))
+    // Scan the (normalized) query once and report every pattern occurrence.
+    // onMatch(const Match&) is called in order of match end offset and returns
+    // false to stop the scan early. Nothing is allocated during the scan.
+    template <typename Callback>
+    void forEachMatch(const string& query, Callback onMatch) const {
+        const TrieNode* node = root;
+        for (size_t i = 0; i < query.size(); i++) {
+            char ch = query[i];
+            const TrieNode* next = node->child(ch);
+            while (node != root && !next) {
                 node = node->fail;
-            if (node->children.count(ch))
-                node = node->children[ch];
-            // When matches are found, check each one only once
-            if (!node->matchedPatterns.empty()) {
-                for (const string& pattern : node->matchedPatterns) {
-                    if (!patternFound[pattern]) {
-                        patternFound[pattern] = true;
-                        // Weighting: assign higher weight for more critical keywords.
-                        if (pattern.find("; drop") != string::npos || pattern.find("xp_cmdshell") != string::npos ||
-                                pattern.find("; exec") != string::npos || pattern.find("outfile") != string::npos ||
-                                pattern.find("load_file") != string::npos)
-                            riskScore += 100;
-                        else if (pattern.find("; delete") != string::npos || pattern.find("; insert") != string::npos ||
-                                 pattern.find("; truncate") != string::npos || pattern.find("; update") != string::npos ||
-                                 pattern.find("' alter") != string::npos || pattern.find("sleep(") != string::npos || 
-                                 pattern.find("version(") != string::npos || pattern.find("current_user") != string::npos)
-                            riskScore += 15;
-                        else
-                            riskScore += 10;
-                    }
-                }
+                next = node->child(ch);
+            }
+            if (next)
+                node = next;
+            // Walk the dictionary suffix links to enumerate every pattern ending here
+            for (const TrieNode* out = (node->patternId != -1) ? node : node->output;
+                 out != nullptr; out = out->output) {
+                Match match = {out->patternId, i + 1 - out->depth, i + 1};
+                if (!onMatch(match))
+                    return;
             }
         }
-        return riskScore;
+    }
+
+    // Search for SQLi patterns in the (normalized) query.
+    // Counts each distinct pattern only once.
+    int search(const string& query) const {
+        return score(query,
+                     [](int) { return true; },
+                     [&](int patternId) { return weights[patternId]; });
+    }
+
+    // Profile with every current pattern enabled at its default weight; tenants
+    // start from this and disable or reweight the rules they differ on.
+    TenantProfile defaultProfile() const {
+        TenantProfile profile;
+        profile.enabled.assign((patternCount() + 63) / 64, 0);
+        profile.weights.assign(weights.begin(), weights.end());
+        for (size_t id = 0; id < patternCount(); id++)
+            profile.setEnabled(static_cast<int>(id), true);
+        return profile;
+    }
+
+    // Same scan as search(), scored with the given tenant's rule mask and weights.
+    int search(const string& query, const TenantProfile& tenant) const {
+        return score(query,
+                     [&](int patternId) { return tenant.isEnabled(patternId) && tenant.hasWeight(patternId); },
+                     [&](int patternId) { return static_cast<int>(tenant.weights[patternId]); });
     }
 };
 
@@ -177,6 +435,9 @@ int main() {
     // Build the Aho–Corasick automaton.
     detector.build();
 
+    // Default tenant: every rule enabled at its built-in weight.
+    TenantProfile tenant = detector.defaultProfile();
+
     // ------------------------
     // Process CSV dataset file
     // ------------------------
@@ -218,7 +479,7 @@ int main() {
         query = normalize(query);
 
         // Compute risk score and classification using Aho–Corasick search.
-        int riskScore = detector.search(query);
+        int riskScore = detector.search(query, tenant);
         string computedRisk = classifyRisk(riskScore);
 
         bool match = (computedRisk == expectedRisk);
@@ -228,6 +489,14 @@ int main() {
 
         cout << "Query: " << query << endl;
         cout << "Score : " << riskScore << endl;
+        // Report what was flagged and where, for logging/highlighting
+        if (riskScore > 0) {
+            detector.forEachMatch(query, [&](const Match& m) {
+                cout << "  Matched \"" << detector.pattern(m.patternId) << "\" at ["
+                     << m.start << ", " << m.end << ")" << endl;
+                return true;
+            });
+        }
         cout << "Expected Risk: " << expectedRisk << " | Computed Risk: " << computedRisk << endl;
         cout << (match ? "Match" : "Mismatch") << "\n--------------------------" << endl;
     }
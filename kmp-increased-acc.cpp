@@ -54,28 +54,31 @@ vector<int> buildLPS(const string &pattern) {
     return lps;
 }
 
-// KMP search function returns true if 'pattern' is found in 'text'
-bool KMPSearch(const string &text, const string &pattern) {
+// Report every occurrence of 'pattern' in 'text' using a prebuilt LPS array.
+// onMatch(start, end) receives the [start, end) offsets of each occurrence and
+// returns false to stop the scan early. Nothing is allocated during the scan.
+template <typename Callback>
+void KMPForEachMatch(const string &text, const string &pattern, const vector<int> &lps, Callback onMatch) {
     int n = text.length();
     int m = pattern.length();
-    vector<int> lps = buildLPS(pattern);
+    if (m == 0)
+        return;
     int i = 0, j = 0;  // i -> text index, j -> pattern index
     while (i < n) {
         if (text[i] == pattern[j]) {
             i++;
             j++;
-        }
-        if (j == m) {
-            return true;  // Found the pattern in text
-        } else if (i < n && text[i] != pattern[j]) {
-            if (j != 0) {
-                j = lps[j - 1];
-            } else {
-                i++;
+            if (j == m) {
+                if (!onMatch(static_cast<size_t>(i - m), static_cast<size_t>(i)))
+                    return;
+                j = lps[j - 1];  // Keep going to find overlapping occurrences
             }
+        } else if (j != 0) {
+            j = lps[j - 1];
+        } else {
+            i++;
         }
     }
-    return false;
 }
 
 // ------------------------
@@ -148,10 +151,12 @@ int main() {
     int totalQueries = 0;
     int correctCount = 0;
     
-    // Pre-normalize all patterns (once outside the loop)
+    // Pre-normalize all patterns and build their LPS arrays (once outside the loop)
     vector<string> normalized_patterns;
+    vector<vector<int>> pattern_lps;
     for (const string &pattern : sqli_patterns) {
         normalized_patterns.push_back(normalize(pattern));
+        pattern_lps.push_back(buildLPS(normalized_patterns.back()));
     }
 
     // Timing variables
@@ -194,12 +199,13 @@ int main() {
             
             // If the normalized pattern is found in the normalized query
             // and hasn't been counted yet, add its weight.
-            if (KMPSearch(normQuery, normPattern)) {
+            KMPForEachMatch(normQuery, normPattern, pattern_lps[i], [&](size_t, size_t) {
                 if (foundPatterns.find(pattern) == foundPatterns.end()) {
                     foundPatterns.insert(pattern);
                     riskScore += keywordWeights[pattern];
                 }
-            }
+                return false;  // Each pattern is only counted once
+            });
         }
         
         // End timing for KMP search
@@ -1,58 +1,279 @@
 #include <iostream>
+#include <iomanip>
 #include <vector>
-#include <unordered_map>
+#include <memory>
+#include <cstdint>
 #include <queue>
+#include <unordered_map>
+#include <thread>
+#include <system_error>
+#include <random>
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 
 #ifdef _WIN32
 #include <windows.h>
 #include <psapi.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <unistd.h>
 #endif
 
 using namespace std;
 using namespace std::chrono;
 
 // ============================ AHO-CORASICK IMPLEMENTATION ============================
+struct Match {
+    int patternId;
+    size_t start;
+    size_t end;
+};
+
+template <typename T, size_t BlockSize>
+class BlockPool {
+private:
+    vector<unique_ptr<T[]>> blocks;
+    size_t used;
+
+public:
+    BlockPool() : used(BlockSize) {}
+
+    T* allocate(size_t n) {
+        if (used + n > BlockSize) {
+            blocks.emplace_back(new T[BlockSize]);
+            used = 0;
+        }
+        T* run = &blocks.back()[used];
+        used += n;
+        return run;
+    }
+
+    size_t bytes() const { return blocks.size() * BlockSize * sizeof(T); }
+};
+
 struct TrieNode {
-    unordered_map<char, TrieNode*> children;
+    char* labels;
+    TrieNode** targets;
     TrieNode* fail;
-    vector<string> matchedPatterns;
-    TrieNode() : fail(nullptr) {}
+    TrieNode* output;       // dictionary suffix link
+    int patternId;
+    int depth;              // length of the pattern ending here
+    uint16_t childCount;
+    uint16_t childCapacity;
+    TrieNode() : labels(nullptr), targets(nullptr), fail(nullptr), output(nullptr),
+                 patternId(-1), depth(0), childCount(0), childCapacity(0) {}
+
+    TrieNode* child(char ch) const {
+        for (int i = 0; i < childCount; i++)
+            if (labels[i] == ch)
+                return targets[i];
+        return nullptr;
+    }
 };
 
 class AhoCorasick {
 private:
+    BlockPool<TrieNode, 4096> nodePool;
+    BlockPool<char, 65536> labelPool;
+    BlockPool<TrieNode*, 8192> targetPool;
+    size_t nodes;
     TrieNode* root;
+    string patternText;
+    vector<size_t> patternStarts;
+
+    static const size_t PARALLEL_LEVEL_THRESHOLD = 4096;
+
+    TrieNode* newNode() {
+        nodes++;
+        return nodePool.allocate(1);
+    }
+
+    void addChild(TrieNode* node, char ch, TrieNode* child) {
+        if (node->childCount == node->childCapacity) {
+            uint16_t capacity = node->childCapacity ? node->childCapacity * 2 : 1;
+            char* labels = labelPool.allocate(capacity);
+            TrieNode** targets = targetPool.allocate(capacity);
+            copy(node->labels, node->labels + node->childCount, labels);
+            copy(node->targets, node->targets + node->childCount, targets);
+            node->labels = labels;
+            node->targets = targets;
+            node->childCapacity = capacity;
+        }
+        node->labels[node->childCount] = ch;
+        node->targets[node->childCount++] = child;
+    }
+
+    void linkChildren(const vector<TrieNode*>& parents, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            TrieNode* current = parents[i];
+            for (int c = 0; c < current->childCount; c++) {
+                char ch = current->labels[c];
+                TrieNode* child = current->targets[c];
+                if (current == root) {
+                    child->fail = root;
+                } else {
+                    TrieNode* failure = current->fail;
+                    while (failure != root && !failure->child(ch))
+                        failure = failure->fail;
+                    TrieNode* next = failure->child(ch);
+                    child->fail = next ? next : root;
+                }
+                child->output = (child->fail->patternId != -1) ? child->fail : child->fail->output;
+            }
+        }
+    }
 
 public:
-    AhoCorasick() { root = new TrieNode(); }
+    AhoCorasick() : nodes(0), patternStarts(1, 0) { root = newNode(); }
+    AhoCorasick(const AhoCorasick&) = delete;
+    AhoCorasick& operator=(const AhoCorasick&) = delete;
 
-    void insert(const string& keyword) {
+    int insert(const string& keyword) {
         TrieNode* node = root;
         for (char ch : keyword) {
-            if (!node->children[ch])
-                node->children[ch] = new TrieNode();
+            TrieNode* next = node->child(ch);
+            if (!next) {
+                next = newNode();
+                next->depth = node->depth + 1;
+                addChild(node, ch, next);
+            }
+            node = next;
+        }
+        if (node->patternId == -1) {
+            node->patternId = static_cast<int>(patternStarts.size() - 1);
+            patternText += keyword;
+            patternStarts.push_back(patternText.size());
+        }
+        return node->patternId;
+    }
+
+    void build(unsigned threads = 0) {
+        if (threads == 0)
+            threads = max(1u, thread::hardware_concurrency());
+        root->fail = root;
+        vector<TrieNode*> level(1, root), nextLevel;
+        while (!level.empty()) {
+            size_t workers = min<size_t>(threads, level.size() / PARALLEL_LEVEL_THRESHOLD);
+            if (workers <= 1) {
+                linkChildren(level, 0, level.size());
+            } else {
+                vector<thread> pool;
+                pool.reserve(workers);
+                size_t chunk = (level.size() + workers - 1) / workers;
+                size_t begin = 0;
+                try {
+                    for (; begin < level.size(); begin += chunk)
+                        pool.emplace_back(&AhoCorasick::linkChildren, this, cref(level),
+                                          begin, min(begin + chunk, level.size()));
+                } catch (const system_error&) {
+                    linkChildren(level, begin, level.size());
+                }
+                for (thread& worker : pool)
+                    worker.join();
+            }
+            nextLevel.clear();
+            for (TrieNode* node : level)
+                nextLevel.insert(nextLevel.end(), node->targets, node->targets + node->childCount);
+            level.swap(nextLevel);
+        }
+    }
+
+    size_t nodeCount() const { return nodes; }
+
+    size_t memoryUsage() const {
+        size_t bytes = nodePool.bytes() + labelPool.bytes() + targetPool.bytes();
+        bytes += patternText.capacity() + patternStarts.capacity() * sizeof(size_t);
+        return bytes;
+    }
+
+    template <typename Callback>
+    void forEachMatch(const string& query, Callback onMatch) const {
+        const TrieNode* node = root;
+        for (size_t i = 0; i < query.size(); i++) {
+            char ch = query[i];
+            const TrieNode* next = node->child(ch);
+            while (node != root && !next) {
+                node = node->fail;
+                next = node->child(ch);
+            }
+            if (next)
+                node = next;
+            for (const TrieNode* out = (node->patternId != -1) ? node : node->output;
+                 out != nullptr; out = out->output) {
+                Match match = {out->patternId, i + 1 - out->depth, i + 1};
+                if (!onMatch(match))
+                    return;
+            }
+        }
+    }
+
+    int search(const string& query) const {
+        int matchCount = 0;
+        forEachMatch(query, [&](const Match&) {
+            matchCount++;
+            return true;
+        });
+        return matchCount;
+    }
+};
+
+// ====================== LEGACY AHO-CORASICK (copy-vector build baseline) ======================
+// The previous construction: every node is allocated with new and build() copies the
+// fail target's matchedPatterns into each child. Kept only to compare build cost.
+struct LegacyTrieNode {
+    unordered_map<char, LegacyTrieNode*> children;
+    LegacyTrieNode* fail;
+    vector<string> matchedPatterns;
+    LegacyTrieNode() : fail(nullptr) {}
+};
+
+class LegacyAhoCorasick {
+private:
+    LegacyTrieNode* root;
+    vector<LegacyTrieNode*> nodes;   // only so the benchmark can release them
+
+public:
+    LegacyAhoCorasick() {
+        root = new LegacyTrieNode();
+        nodes.push_back(root);
+    }
+    ~LegacyAhoCorasick() {
+        for (LegacyTrieNode* node : nodes)
+            delete node;
+    }
+    LegacyAhoCorasick(const LegacyAhoCorasick&) = delete;
+    LegacyAhoCorasick& operator=(const LegacyAhoCorasick&) = delete;
+
+    void insert(const string& keyword) {
+        LegacyTrieNode* node = root;
+        for (char ch : keyword) {
+            if (!node->children[ch]) {
+                node->children[ch] = new LegacyTrieNode();
+                nodes.push_back(node->children[ch]);
+            }
             node = node->children[ch];
         }
         node->matchedPatterns.push_back(keyword);
     }
 
     void build() {
-        queue<TrieNode*> q;
+        queue<LegacyTrieNode*> q;
         root->fail = root;
         for (auto& pair : root->children) {
             pair.second->fail = root;
             q.push(pair.second);
         }
         while (!q.empty()) {
-            TrieNode* current = q.front();
+            LegacyTrieNode* current = q.front();
             q.pop();
             for (auto& pair : current->children) {
                 char ch = pair.first;
-                TrieNode* child = pair.second;
-                TrieNode* failure = current->fail;
+                LegacyTrieNode* child = pair.second;
+                LegacyTrieNode* failure = current->fail;
                 while (failure != root && failure->children.find(ch) == failure->children.end()) {
                     failure = failure->fail;
                 }
@@ -70,19 +291,19 @@ public:
         }
     }
 
-    int search(const string& query) {
-        TrieNode* node = root;
-        int matchCount = 0;
-        for (char ch : query) {
-            while (node != root && node->children.find(ch) == node->children.end()) {
-                node = node->fail;
-            }
-            if (node->children.find(ch) != node->children.end()) {
-                node = node->children[ch];
-            }
-            matchCount += node->matchedPatterns.size();
+    size_t nodeCount() const { return nodes.size(); }
+
+    // Rough footprint: nodes, hash map entries and buckets, and the copied pattern strings
+    size_t memoryUsage() const {
+        size_t bytes = 0;
+        for (const LegacyTrieNode* node : nodes) {
+            bytes += sizeof(LegacyTrieNode);
+            bytes += node->children.size() * (sizeof(pair<const char, LegacyTrieNode*>) + 2 * sizeof(void*));
+            bytes += node->children.bucket_count() * sizeof(void*);
+            for (const string& p : node->matchedPatterns)
+                bytes += sizeof(string) + p.capacity();
         }
-        return matchCount;
+        return bytes;
     }
 };
 
@@ -137,12 +358,171 @@ size_t getMemoryUsage() {
     if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
         return pmc.WorkingSetSize; // in bytes
     }
+#elif defined(__linux__)
+    ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if (statm >> totalPages >> residentPages) {
+        return residentPages * sysconf(_SC_PAGESIZE); // in bytes
+    }
+#endif
+    return 0;
+}
+
+// Peak resident memory of this process so far, in bytes
+size_t getPeakMemoryUsage() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.PeakWorkingSetSize;
+    }
+#elif defined(__linux__)
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return stoul(line.substr(6)) * 1024; // reported in kB
+    }
 #endif
     return 0;
 }
 
+// ============================ BUILD SCALING BENCHMARK ============================
+// Generate 'count' distinct synthetic rules by chaining the base SQLi patterns with
+// short random identifiers, so that rules overlap the way vendor feeds do.
+vector<string> generatePatterns(const vector<string>& base, size_t count) {
+    mt19937 rng(42);
+    vector<string> patterns;
+    patterns.reserve(count);
+    for (size_t i = 0; patterns.size() < count; i++) {
+        string pattern = base[rng() % base.size()];
+        int tokens = rng() % 3;
+        for (int t = 0; t < tokens; t++)
+            pattern += " " + base[rng() % base.size()];
+        pattern += " ";
+        for (size_t n = i; n > 0; n /= 26)
+            pattern += static_cast<char>('a' + n % 26);
+        patterns.push_back(pattern);
+    }
+    return patterns;
+}
+
+struct BuildTiming {
+    long long insertUs;
+    long long linkUs;
+};
+
+// Average insert and link time over 'repeats' freshly constructed automatons,
+// so that no run starts from a cache-warm or already linked trie.
+template <typename Automaton, typename Link>
+BuildTiming timeBuild(const vector<string>& patterns, int repeats, Link link) {
+    long long insertUs = 0, linkUs = 0;
+    for (int r = 0; r < repeats; r++) {
+        Automaton aho;
+        auto start = high_resolution_clock::now();
+        for (const string& pattern : patterns)
+            aho.insert(pattern);
+        auto inserted = high_resolution_clock::now();
+        link(aho);
+        auto linked = high_resolution_clock::now();
+        insertUs += duration_cast<microseconds>(inserted - start).count();
+        linkUs += duration_cast<microseconds>(linked - inserted).count();
+    }
+    BuildTiming timing = {insertUs / repeats, linkUs / repeats};
+    return timing;
+}
+
+// Small rule sets build in well under a millisecond, so repeat them enough
+// times for the average to be meaningful.
+int repeatsFor(size_t count) {
+    return count < 100000 ? static_cast<int>(100000 / count) : 1;
+}
+
+// Child-process side of the footprint measurement: build one automaton over 'count'
+// synthetic patterns and print "nodes automatonBytes peakGrowthBytes", where the
+// peak growth is this process's peak RSS above its RSS just before inserting.
+template <typename Automaton, typename Link>
+int runFootprint(const vector<string>& base, size_t count, Link link) {
+    vector<string> patterns = generatePatterns(base, count);
+    size_t residentBefore = getMemoryUsage();
+    Automaton aho;
+    for (const string& pattern : patterns)
+        aho.insert(pattern);
+    link(aho);
+    size_t peak = getPeakMemoryUsage();
+    cout << aho.nodeCount() << " " << aho.memoryUsage() << " "
+         << (peak > residentBefore ? peak - residentBefore : 0) << endl;
+    return 0;
+}
+
+// Measure one rule-set size in a fresh process, so the peak is not masked by memory
+// the benchmark already touched, and print the Nodes/Automaton KB/Peak +KB columns.
+void reportFootprint(const string& self, size_t count, bool legacy) {
+    string command = "\"" + self + "\" --footprint " + (legacy ? "legacy " : "arena ") + to_string(count);
+    size_t nodes = 0, automatonBytes = 0, peakGrowth = 0;
+    bool ok = false;
+    if (FILE* child = popen(command.c_str(), "r")) {
+        unsigned long long n, a, g;
+        if (fscanf(child, "%llu %llu %llu", &n, &a, &g) == 3) {
+            nodes = n;
+            automatonBytes = a;
+            peakGrowth = g;
+            ok = true;
+        }
+        pclose(child);
+    }
+    if (!ok) {
+        cout << setw(12) << "n/a" << setw(16) << "n/a" << setw(14) << "n/a" << endl;
+        return;
+    }
+    cout << setw(12) << nodes << setw(16) << automatonBytes / 1024
+         << setw(14) << peakGrowth / 1024 << endl;
+}
+
+// For each rule-set size report insert time, failure-link time on one thread and on
+// all threads (microseconds, averaged over repeats), node count, the automaton's own
+// byte count, and "Peak +KB": the peak RSS of a separate process building only that
+// rule set, above its RSS before insertion. The legacy copy-vector build is shown at
+// the small sizes as a baseline.
+void benchmarkBuild(const string& self, const vector<string>& base) {
+    const size_t sizes[] = {1000, 10000, 100000, 1000000};
+    const size_t legacySizes[] = {1000, 10000};
+    unsigned threads = max(1u, thread::hardware_concurrency());
+
+    auto linkSingle = [](AhoCorasick& aho) { aho.build(1); };
+    auto linkParallel = [threads](AhoCorasick& aho) { aho.build(threads); };
+    auto linkLegacy = [](LegacyAhoCorasick& aho) { aho.build(); };
+
+    cout << "\n===== Automaton Construction Benchmark (" << threads << " threads) =====\n";
+    cout << setw(10) << "Patterns" << setw(12) << "Insert us" << setw(12) << "Link 1T us"
+         << setw(12) << "Link NT us" << setw(12) << "Nodes"
+         << setw(16) << "Automaton KB" << setw(14) << "Peak +KB" << endl;
+
+    for (size_t count : sizes) {
+        vector<string> patterns = generatePatterns(base, count);
+        int repeats = repeatsFor(count);
+        BuildTiming single = timeBuild<AhoCorasick>(patterns, repeats, linkSingle);
+        BuildTiming parallel = timeBuild<AhoCorasick>(patterns, repeats, linkParallel);
+        cout << setw(10) << count << setw(12) << single.insertUs
+             << setw(12) << single.linkUs << setw(12) << parallel.linkUs;
+        reportFootprint(self, count, false);
+    }
+
+    cout << "\n----- Legacy copy-vector build (baseline) -----\n";
+    cout << setw(10) << "Patterns" << setw(12) << "Insert us" << setw(12) << "Link us"
+         << setw(12) << "" << setw(12) << "Nodes"
+         << setw(16) << "Automaton KB" << setw(14) << "Peak +KB" << endl;
+
+    for (size_t count : legacySizes) {
+        vector<string> patterns = generatePatterns(base, count);
+        BuildTiming legacy = timeBuild<LegacyAhoCorasick>(patterns, repeatsFor(count), linkLegacy);
+        cout << setw(10) << count << setw(12) << legacy.insertUs
+             << setw(12) << legacy.linkUs << setw(12) << "";
+        reportFootprint(self, count, true);
+    }
+}
+
 // ============================ BENCHMARKING CODE ============================
-int main() {
+int main(int argc, char* argv[]) {
     // vector<string> sqli_patterns = {
     //     "UNION", "SELECT", "DROP", "INSERT", "DELETE", "UPDATE",
     //     "OR 1=1", "--", "#", "/*", "*/", "SLEEP(", "BENCHMARK("
@@ -161,6 +541,15 @@ int main() {
         "null", "version(", "; exec", "xp_cmdshell", "outfile", "load_file"
     };
 
+    // Footprint child process started by benchmarkBuild: --footprint <arena|legacy> <count>
+    if (argc == 4 && string(argv[1]) == "--footprint") {
+        size_t count = stoul(argv[3]);
+        if (string(argv[2]) == "legacy")
+            return runFootprint<LegacyAhoCorasick>(sqli_patterns, count,
+                                                   [](LegacyAhoCorasick& aho) { aho.build(); });
+        return runFootprint<AhoCorasick>(sqli_patterns, count, [](AhoCorasick& aho) { aho.build(); });
+    }
+
     AhoCorasick aho;
     for (const string& pattern : sqli_patterns)
         aho.insert(pattern);
@@ -225,6 +614,8 @@ int main() {
 
 
 
+    benchmarkBuild(argv[0], sqli_patterns);
+
     // Optionally, you can compare detection results between the two methods.
     // cout << "\n===== Detection Results (for a sample of queries) =====\n";
     // for (const string& query : queries) {